@@ -12,11 +12,17 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <functional>
+
+// Local includes
+#include "RunStatistics.h"
 
 // Forward declarations
 class TH1S;
 class TH1F;
 class TH2F;
+class TFile;
+class THnSparse;
 class TTree;
 class TEfficiency;
 
@@ -24,92 +30,284 @@ class EfficiencyPlots {
 
   public:
 
+    // Cuts selecting flashes: minimum number of photon detectors 
+    // with some signal on them that a flash has to have in order 
+    // to not be discarded and the time window of the signal region (us)
+    struct Cuts {
+      unsigned int fMinimumNPDs;
+      float        fMinimumTime;
+      float        fMaximumTime;
+    };
+
     // Constructor
     // with option being "nobg", "ar39", or "rn222"
+    // and nWorkers being the number of threads processing the files
     EfficiencyPlots(std::string const& option, int const minimumNPDs, 
-                                            bool const debug = false);
+                    bool const debug = false, unsigned int const nWorkers = 1);
+
+    // Constructor for a scan filling the histograms for many sets of cuts
+    // in one pass, e.g., EfficiencyPlots("ar39", { { 2, -1, 10 }, 
+    //                                              { 3, -1, 10 } })
+    // Every set of cuts gets its own directory in the output file,
+    // so sets with the same directory name throw std::invalid_argument
+    EfficiencyPlots(std::string const& option, 
+                    std::vector< Cuts > const& cutsVector, 
+                    bool const debug = false, unsigned int const nWorkers = 1);
 
     // Destructor
     ~EfficiencyPlots();
 
+    // Size of the cache used to read the trees, 30 MB by default
+    // (0 turns it off)
+    void SetTreeCacheSize(long long const cacheSize);
+
+    // Decompress the tree baskets in a separate thread, off by default
+    void SetParallelUnzip(bool const parallelUnzip);
+
+    // Keep track of the time spent opening files, reading every tree,
+    // counting PDs with signal, filling and writing histograms, 
+    // and save it with the event and flash rates and the peak memory use
+    // to <output name>_statistics.json, off by default
+    void SetRunStatistics(bool const runStatistics);
+
     // Process the data, fill the histograms
     void Fill();
 
+    // Extract the quantities of every flash used by Fill from the data
+    // into a small flash cache file (independent of the cuts)
+    void WriteFlashCache();
+
+    // Fill the histograms from the flash cache made by WriteFlashCache,
+    // which is much faster than Fill when only the cuts change
+    void FillFromFlashCache();
+
+    // Same output as Fill, but the flashes of every ROOT file are kept
+    // in its own flash cache, so that the next run only reads the files
+    // that are new or changed (by size or modification time) since then,
+    // or that were not finished when the last run was killed
+    void FillIncrementally();
+
   private:
 
-    // Process one ROOT file, filling every histogram we have
-    void AnalyzeRootFile(std::string const& filename);
+    // Constructor both public ones delegate to
+    EfficiencyPlots(std::string const& option, 
+                    std::vector< Cuts > const& cutsVector, bool const scan,
+                    bool const debug, unsigned int const nWorkers);
+
+    // All the histograms we fill, kept together so that
+    // each worker thread can have its own copy merged at the end
+    struct Histograms {
+
+      // Flash time distributions in the background region 
+      // for different threshold values
+      std::map< int, TH1F* > fBackgroundHists;
+
+      // PEs-vs-NSignalPDs 2D distribution for background flashes
+      // for different threshold values
+      std::map< int, TH2F* > fBackgroundPEVsNPDHistMap;
+      
+      std::map< int, TH2F* > fBackgroundPEVsYWidthHistMap;
+      std::map< int, TH2F* > fBackgroundPEVsZWidthHistMap;
+
+      // Flash time distributions in the signal region 
+      // for different energy and threshold values
+      std::map< int, std::map< int, TH2F* > > fSignalHists;
+
+      // PEs-vs-NSignalPDs 2D distribution for flashes in the signal region
+      // for different energy and threshold values
+      // (these have tens of millions of mostly empty bins, so they are
+      //  kept sparse and only turned into TH2Fs when written out)
+      std::map< int, std::map< int, THnSparse* > > fSignalPEVsNPDHistMap;
+
+      std::map< int, std::map< int, THnSparse* > > fSignalPEVsYWidthHistMap;
+      std::map< int, std::map< int, THnSparse* > > fSignalPEVsZWidthHistMap;
+
+      // Efficiency distributions in the singal range 
+      // for different energy and threshold values
+      std::map< int, std::map< int, TEfficiency* > > fEfficiencyHists;
+
+      // Number of flashes in the signal range distributions 
+      // for different energy and threshold values
+      std::map< int, std::map< int, TH1S* > > fNumberOfFlashesHists;
+
+    };
+
+    // Truth information about the first primary particle in an event
+    struct Primary {
+      float fMomentum; // GeV
+      float fStartX;   // cm
+    };
+
+    // Quantities of a flash needed to fill the histograms
+    struct Flash {
+      float        fTime;       // us
+      float        fTotalPE;
+      float        fYWidth;     // cm
+      float        fZWidth;     // cm
+      unsigned int fNSignalPDs;
+    };
+
+    // Function called for every event and threshold 
+    // with the primary particle and all the flashes of the event
+    typedef std::function< void (int const threshold, Primary const& primary,
+                                 std::vector< Flash > const& flashes) > 
+                                                          EventProcessor;
+
+    // Names of the output file and of the flash cache file, 
+    // and the directory with the data
+    std::string GetOutputFilename    () const;
+    std::string GetStatisticsFilename(std::string const& filename) const;
+    std::string GetCutsDirectory     (Cuts const& cuts) const;
+    std::string GetFlashCacheFilename() const;
+    std::string GetDataDirectory     () const;
+
+    // Directory and index of the flash caches of single ROOT files
+    // made by FillIncrementally, and the cache of one file
+    std::string GetPartialCacheDirectory    () const;
+    std::string GetPartialCacheIndexFilename() const;
+    std::string GetPartialCacheFilename(std::string const& filename) const;
+
+    // Whether a flash cache can be read, 
+    // so that a deleted or broken one is made again
+    bool IsFlashCacheReadable(std::string const& filename) const;
+
+    // Size and modification time of a file telling whether it changed
+    std::string GetFileKey(std::string const& filename) const;
+
+    // Read and write the index: file path -> key when it was converted
+    std::map< std::string, std::string > ReadPartialCacheIndex() const;
+    void WritePartialCacheIndex
+                 (std::map< std::string, std::string > const& index) const;
+
+    // Create, delete, add up, and save a set of histograms
+    void BookHistograms  (Histograms      & histograms);
+    void DeleteHistograms(Histograms      & histograms) const;
+    void MergeHistograms (Histograms      & target, 
+                          Histograms const& source    ) const;
+    void WriteHistograms (Histograms const& histograms) const;
+
+    // Add up two TH1S saturating the bins at 32767 as filling them does
+    void MergeShortHist(TH1S* const target, TH1S const* const source) const;
+
+    // Save the histograms of every set of cuts to the output file
+    void WriteAllHistograms(TFile& output) const;
+
+    // Process all the files using fNWorkers threads,
+    // every thread filling its own set of histograms
+    void AnalyzeRootFilesInParallel
+                          (std::vector< std::string > const& filenames);
+
+    // Process one ROOT file, filling every histogram 
+    // in the sets (one per set of cuts)
+    void AnalyzeRootFile(std::string const& filename, 
+                         std::vector< Histograms >& histogramSets);
+
+    // Read the flashes of every event in a ROOT file (or in the flash cache),
+    // the statistics getting the time spent in processEvent as processStage
+    // and the events of the file only if countEvents
+    void ReadRootFile  (std::string const& filename, 
+                        EventProcessor const& processEvent,
+                        std::string const& processStage, 
+                        bool const countEvents);
+    void ReadFlashCache(std::string const& filename, 
+                        EventProcessor const& processEvent);
+
+    // Convert the ROOT files into one flash cache file
+    // (countEvents as for ReadRootFile)
+    void WriteFlashCache(std::vector< std::string > const& filenames,
+                         std::string const& cacheFilename,
+                         bool const countEvents);
+
+    // Fill the histograms of one threshold with one event
+    // for every set of cuts or for one of them
+    void FillEventHistograms(std::vector< Histograms >& histogramSets, 
+                             int const threshold, Primary const& primary,
+                             std::vector< Flash > const& flashes) const;
+    void FillEventHistograms(Histograms& histograms, Cuts const& cuts,
+                             int const threshold, Primary const& primary,
+                             std::vector< Flash > const& flashes) const;
+
+    // Read only the given branches of a tree, prefetching them with TTreeCache
+    void ConfigureTreeReading(TTree* const tree, 
+                              std::vector< std::string > const& branches) const;
 
     // Get a list of all ROOT files in one directory
     // that have "flashes_" in their names
     std::vector< std::string > GetRootFiles(std::string const& directory) const;
 
     // Cuts used mostly to calculate efficiencies
-    bool FlashTimeCut(float const flashTime) const;
+    bool FlashTimeCut(float const flashTime, Cuts const& cuts) const;
 
     // Cuts used to fill histograms
-    bool NSignalPDCut(unsigned int const NSignalPDs) const;
+    bool NSignalPDCut(unsigned int const NSignalPDs, Cuts const& cuts) const;
+
+    // Print the PEs in every channel and PD of a flash (for debugging)
+    void PrintPEsPerPD(std::vector< float > const& PEsPerFlashPerChannel,
+                       int const flashID, int const NChannels) const;
+
+    // Make a 2D sparse histogram with the same binning a TH2F would have
+    THnSparse* MakeSparseHist(std::string const& name, 
+                              std::string const& title,
+                              int const nBinsX, double const xMin, 
+                                                double const xMax,
+                              int const nBinsY, double const yMin, 
+                                                double const yMax) const;
 
-    // Get the number of PDs that have hits
-    unsigned int GetNSignalPDs
-      (std::vector< float > const& PEsPerFlashPerChannel,
-       int const flashID, int const NFlashes, int const NChannels) const;
+    // Fill a 2D sparse histogram the way TH2F::Fill(x, y) would
+    void FillSparseHist(THnSparse* const hist, double const x, 
+                                               double const y) const;
+
+    // Make a dense TH2F with the same name, binning, and content
+    // as the 2D sparse histogram (the caller owns the result)
+    TH2F* MakeDenseHist(THnSparse const* const hist) const;
 
     // Improve the histogram by adjusting its width, etc.
     void ImproveHist(TH1F* const hist);
     void ImproveHist(TH1S* const hist);
 
-    // Get the maximum value for a certain int branch in a TTree
-    int TTreeGetMaxIntValue(std::string const& branch, 
-                                    TTree* const tree) const;
+    // Read the primary particle of every event in the analysis tree
+    std::vector< Primary > GetPrimaries(TTree* const anaTree) const;
     
     // Depending on whether we want to process statistics with or without Ar39
     // this string is set to "nobg", "ar39", or "rn222"
     std::string const fOption;
 
-    // Mininmum number of photon detectors with some signal on them
-    // that a flash has to have in order to not be discarded
-    unsigned int const fMinimumNPDs;
+    // Sets of cuts to fill the histograms for
+    std::vector< Cuts > const fCutsVector;
+
+    // Whether we scan the sets of cuts (and write them to separate
+    // directories of one file) or just use one of them as before
+    bool const fScan;
 
     // Assume that all photon detectors have the same number of channels
     int const fNChannelsPerPD;
 
+    // Assume that a PD has some signal on it 
+    // if its number of PEs is greater than this
+    float const fMinimumPEs;
+
     // Vector containing different optical flash threshold values
     std::vector< int > const fThresholdValues;
 
     // Vector containing different simulated energy values
     std::vector< int > const fEnergyValues;
 
-    // Flash time distributions in the background region 
-    // for different threshold values
-    std::map< int, TH1F* > fBackgroundHists;
+    // Histograms filled by the class (or merged from the worker threads),
+    // one set for every set of cuts
+    std::vector< Histograms > fHistograms;
 
-    // PEs-vs-NSignalPDs 2D distribution for background flashes
-    // for different threshold values
-    std::map< int, TH2F* > fBackgroundPEVsNPDHistMap;
-    
-    std::map< int, TH2F* > fBackgroundPEVsYWidthHistMap;
-    std::map< int, TH2F* > fBackgroundPEVsZWidthHistMap;
-
-    // Flash time distributions in the signal region 
-    // for different energy and threshold values
-    std::map< int, std::map< int, TH2F* > > fSignalHists;
-
-    // PEs-vs-NSignalPDs 2D distribution for flashes in the signal region
-    // for different energy and threshold values
-    std::map< int, std::map< int, TH2F* > > fSignalPEVsNPDHistMap;
+    bool const fDebug;
 
-    std::map< int, std::map< int, TH2F* > > fSignalPEVsYWidthHistMap;
-    std::map< int, std::map< int, TH2F* > > fSignalPEVsZWidthHistMap;
+    // Number of threads processing the ROOT files
+    unsigned int const fNWorkers;
 
-    // Efficiency distributions in the singal range 
-    // for different energy and threshold values
-    std::map< int, std::map< int, TEfficiency* > > fEfficiencyHists;
+    // Size of the TTreeCache for every tree we read (in bytes)
+    long long fTreeCacheSize;
 
-    // Number of flashes in the signal range distributions 
-    // for different energy and threshold values
-    std::map< int, std::map< int, TH1S* > > fNumberOfFlashesHists;
+    // Whether to decompress the baskets in a separate thread
+    bool fParallelUnzip;
 
-    bool const fDebug;
+    // Time spent in every stage of the job (if enabled)
+    RunStatistics fStatistics;
 
 };
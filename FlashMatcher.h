@@ -0,0 +1,51 @@
+//=============================================================================
+// FlashMatcher.h
+//
+// This class matches the flashes of one event found with one flash threshold
+// (one opflashana<N> tree) to the flashes found with another threshold
+// by their times: each list is sorted once, and the sorted lists are 
+// walked through together instead of comparing every pair
+//=============================================================================
+
+#ifndef FLASHMATCHER_H
+#define FLASHMATCHER_H
+
+// C++ includes
+#include <vector>
+#include <cstddef>
+
+class FlashMatcher {
+
+  public:
+
+    // A flash to match: its time and its number within the event
+    struct Flash {
+      float fTime; // us
+      int   fID;
+    };
+
+    // Constructor
+    // with flashes being matched if their times differ
+    // by no more than tolerance (in us), 0 meaning exact equality
+    FlashMatcher(float const tolerance = 0.0);
+
+    // Sort the flashes by time (keeping the order of equal times),
+    // as Match needs them, once for every list
+    static void SortByTime(std::vector< Flash >& flashes);
+
+    // For every flash in the first list return the ID of the closest flash
+    // in the second list within the tolerance, or -1 if there is none
+    // (several flashes of the first list can match the same flash).
+    // Both lists have to be sorted by SortByTime.
+    std::vector< int > Match(std::vector< Flash > const& flashes,
+                             std::vector< Flash > const& referenceFlashes) 
+                                                                       const;
+
+  private:
+
+    // Maximum time difference of matched flashes
+    float const fTolerance;
+
+};
+
+#endif
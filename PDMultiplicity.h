@@ -0,0 +1,92 @@
+//=============================================================================
+// PDMultiplicity.h
+//
+// Count photon detectors with signal for all flashes of an event at once
+// (used by EfficiencyPlots and the macros in miscellanea/)
+//=============================================================================
+
+#ifndef PDMULTIPLICITY_H
+#define PDMULTIPLICITY_H
+
+// C++ includes
+#include <vector>
+#include <stdexcept>
+
+namespace pdmultiplicity {
+
+  //---------------------------------------------------------------------------
+  // The one loop counting PDs with signal. With FixedChannelsPerPD > 0
+  // the number of channels per PD is known at compile time:
+  // the per-PD sums are fully unrolled and the loop over PDs
+  // has no branches, so the compiler can vectorize it across PDs.
+  // With FixedChannelsPerPD = 0 NChannelsPerPD is used instead.
+  // The channels of each PD are still summed in their original order,
+  // so the result is identical to the channel-by-channel loop.
+  template < int FixedChannelsPerPD >
+  inline void CountSignalPDsKernel(float const* const PEsPerFlashPerChannel,
+                                   int const NFlashes, int const NChannels,
+                                   int const NChannelsPerPDAtRunTime,
+                                   float const minimumPEs,
+                                   unsigned int* const NSignalPDs) {
+
+    int const NChannelsPerPD = (FixedChannelsPerPD > 0) ? FixedChannelsPerPD
+                                                  : NChannelsPerPDAtRunTime;
+    int const NPDs = NChannels/NChannelsPerPD;
+    for (int flash = 0; flash < NFlashes; ++flash) {
+      float const* const PEs = PEsPerFlashPerChannel + flash*NChannels;
+      unsigned int signalPDs = 0;
+      for (int PD = 0; PD < NPDs; ++PD) {
+        float const* const PEsOfPD = PEs + PD*NChannelsPerPD;
+        float PEsPerPD = 0.0;
+        for (int channel = 0; channel < NChannelsPerPD; ++channel)
+          PEsPerPD += PEsOfPD[channel];
+        signalPDs += (PEsPerPD > minimumPEs);
+      }
+      NSignalPDs[flash] = signalPDs;
+    }
+
+  }
+
+  //---------------------------------------------------------------------------
+  // Fill NSignalPDs[flash] with the number of PDs (groups of NChannelsPerPD
+  // consecutive channels) whose PEs add up to more than minimumPEs
+  // for every flash in the event. PEsPerFlashPerChannel has to hold
+  // NFlashes*NChannels values, flash after flash, as in OpFlashAna trees.
+  // Channels left over after the last full PD are ignored.
+  inline void CountSignalPDs(float const* const PEsPerFlashPerChannel,
+                             int const NFlashes, int const NChannels,
+                             int const NChannelsPerPD, float const minimumPEs,
+                             unsigned int* const NSignalPDs) {
+
+    // Every PD in the DUNE geometries we simulate has 12 channels
+    if (NChannelsPerPD == 12)
+      CountSignalPDsKernel< 12 >(PEsPerFlashPerChannel, NFlashes, NChannels,
+                                 NChannelsPerPD, minimumPEs, NSignalPDs);
+    else
+      CountSignalPDsKernel< 0  >(PEsPerFlashPerChannel, NFlashes, NChannels,
+                                 NChannelsPerPD, minimumPEs, NSignalPDs);
+
+  }
+
+  //---------------------------------------------------------------------------
+  // Convenience version checking the input size (like vector::at would)
+  // and resizing the output vector
+  inline void CountSignalPDs(std::vector< float > const& PEsPerFlashPerChannel,
+                             int const NFlashes, int const NChannels,
+                             int const NChannelsPerPD, float const minimumPEs,
+                             std::vector< unsigned int >& NSignalPDs) {
+
+    if (PEsPerFlashPerChannel.size() < size_t(NFlashes)*size_t(NChannels))
+      throw std::out_of_range("CountSignalPDs: fewer PEs than "
+                              "NFlashes*NChannels");
+
+    NSignalPDs.resize(NFlashes);
+    if (NFlashes > 0)
+      CountSignalPDs(PEsPerFlashPerChannel.data(), NFlashes, NChannels,
+                     NChannelsPerPD, minimumPEs, NSignalPDs.data());
+
+  }
+
+}
+
+#endif
@@ -0,0 +1,173 @@
+//=============================================================================
+// RunStatistics.h
+//
+// Opt-in bookkeeping of where the time goes in a job:
+// wall time per processing stage for every input file and for the whole job,
+// numbers of events and flashes, bytes read, and the peak memory use,
+// written out as a JSON summary at the end of the job
+// (header-only, so that it can be used by ROOT macros as is)
+//=============================================================================
+
+#ifndef RUNSTATISTICS_H
+#define RUNSTATISTICS_H
+
+// C++ includes
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+// Other includes
+#include <sys/resource.h>
+
+class RunStatistics {
+
+  public:
+
+    // Time spent in every stage (s) and counters
+    // for one input file or for the whole job
+    struct Record {
+      std::string                     fName;
+      double                          fWallTime  = 0.0;
+      std::map< std::string, double > fStageTimes;
+      long long                       fEvents    = 0;
+      long long                       fFlashes   = 0;
+      long long                       fBytesRead = 0;
+      long long                       fReadCalls = 0;
+      // False for files whose events are counted again later in the job
+      // (converted into a flash cache that is then read)
+      bool                            fCountEvents = true;
+    };
+
+    // Nothing is recorded unless the statistics are enabled
+    void Enable(bool const enabled) { fEnabled = enabled; }
+    bool IsEnabled() const { return fEnabled; }
+
+    // Current time in seconds, 0 if the statistics are disabled,
+    // so that the timing costs nothing when we don't need it
+    double Now() const {
+      if (!fEnabled) return 0.0;
+      return std::chrono::duration< double >
+               (std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Start a new job, forgetting everything recorded before
+    void StartJob(std::string const& name) {
+      std::lock_guard< std::mutex > lock(fMutex);
+      fJob       = Record();
+      fJob.fName = name;
+      fFiles.clear();
+      fJobStart  = Now();
+    }
+
+    // Add the time since start to a stage of the record
+    void AddTime(Record& record, std::string const& stage,
+                                 double const start) const {
+      if (fEnabled) record.fStageTimes[stage] += Now() - start;
+    }
+
+    // Add the time since start to a stage of the whole job
+    void AddJobTime(std::string const& stage, double const start) {
+      if (!fEnabled) return;
+      std::lock_guard< std::mutex > lock(fMutex);
+      AddTime(fJob, stage, start);
+    }
+
+    // Save the record of one input file (can be called from any thread)
+    void AddFile(Record const& record) {
+      if (!fEnabled) return;
+      std::lock_guard< std::mutex > lock(fMutex);
+      fFiles.push_back(record);
+    }
+
+    // Finish the job and write the summary to a JSON file
+    void Write(std::string const& filename) {
+      if (!fEnabled) return;
+      std::lock_guard< std::mutex > lock(fMutex);
+
+      // The job totals are the sums over the files
+      // (so the stage times add up the time of all the threads)
+      // plus the stages of the job itself, with the events and flashes
+      // of every file counted only once
+      Record job = fJob;
+      job.fWallTime = Now() - fJobStart;
+      for (Record const& file : fFiles) {
+        for (auto const& stageTime : file.fStageTimes)
+          job.fStageTimes[stageTime.first] += stageTime.second;
+        if (file.fCountEvents) {
+          job.fEvents  += file.fEvents;
+          job.fFlashes += file.fFlashes;
+        }
+        job.fBytesRead += file.fBytesRead;
+        job.fReadCalls += file.fReadCalls;
+      }
+
+      std::ofstream output(filename);
+      output << "{\n";
+      WriteRecord(output, job, "  ");
+      output << ",\n  \"events_per_s\": "
+             << (job.fWallTime > 0 ? job.fEvents /job.fWallTime : 0.0)
+             << ",\n  \"flashes_per_s\": "
+             << (job.fWallTime > 0 ? job.fFlashes/job.fWallTime : 0.0)
+             << ",\n  \"peak_rss_kb\": " << GetPeakRSS()
+             << ",\n  \"files\": [";
+      for (size_t fileID = 0; fileID < fFiles.size(); ++fileID) {
+        output << (fileID ? ",\n" : "\n") << "    {\n";
+        WriteRecord(output, fFiles[fileID], "      ");
+        output << "\n    }";
+      }
+      output << "\n  ]\n}\n";
+
+      std::cout << "Run statistics saved to " << filename << '\n';
+    }
+
+  private:
+
+    // Write the fields of a record (without the braces)
+    void WriteRecord(std::ostream& output, Record const& record,
+                                     std::string const& indent) const {
+      output << indent << "\"name\": \""     << Escape(record.fName) << "\",\n"
+             << indent << "\"wall_time_s\": " << record.fWallTime    << ",\n"
+             << indent << "\"events\": "      << record.fEvents      << ",\n"
+             << indent << "\"flashes\": "     << record.fFlashes     << ",\n"
+             << indent << "\"bytes_read\": "  << record.fBytesRead   << ",\n"
+             << indent << "\"read_calls\": "  << record.fReadCalls   << ",\n"
+             << indent << "\"stages_s\": {";
+      bool first = true;
+      for (auto const& stageTime : record.fStageTimes) {
+        output << (first ? "\n" : ",\n") << indent << "  \""
+               << Escape(stageTime.first) << "\": " << stageTime.second;
+        first = false;
+      }
+      output << '\n' << indent << '}';
+    }
+
+    // Escape the characters JSON strings can't have as they are
+    static std::string Escape(std::string const& text) {
+      std::string escaped;
+      for (char const character : text) {
+        if (character == '"' || character == '\\') escaped += '\\';
+        escaped += character;
+      }
+      return escaped;
+    }
+
+    // Maximum resident set size of the process so far (kB on Linux)
+    static long GetPeakRSS() {
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage)) return 0;
+      return usage.ru_maxrss;
+    }
+
+    bool                  fEnabled  = false;
+    double                fJobStart = 0.0;
+    Record                fJob;
+    std::vector< Record > fFiles;
+    std::mutex            fMutex;
+
+};
+
+#endif
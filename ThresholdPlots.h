@@ -14,6 +14,9 @@
 #include <vector>
 #include <string>
 
+// Local includes
+#include "RunStatistics.h"
+
 class TH1F;
 class TGraphErrors;
 class TGraphAsymmErrors;
@@ -26,14 +29,31 @@ class ThresholdPlots {
     ThresholdPlots(std::string const& option,
                    unsigned int const minimumNPDs);
 
+    // Constructor reading one set of cuts from the output of an
+    // EfficiencyPlots scan, with cutsDirectory being its directory name,
+    // e.g., ThresholdPlots("ar39", "npds_3_time_-1_10")
+    ThresholdPlots(std::string const& option, 
+                   std::string const& cutsDirectory);
+
     // Destructor
     ~ThresholdPlots();
 
+    // Save the time spent in every stage to <output name>_statistics.json,
+    // off by default
+    void SetRunStatistics(bool const runStatistics);
+
     // Process the data, fill the histograms
     void Fill();
 
   private:
 
+    // Constructor both public ones delegate to
+    ThresholdPlots(std::string const& option,
+                   unsigned int const minimumNPDs,
+                   std::string const& inputFilename,
+                   std::string const& inputDirectory,
+                   std::string const& outputFilename);
+
     // Fill the graphs after everything else is filled
     void FillEfficiencyVSThreshold();
     void FillBackgroundVSThreshold();
@@ -42,6 +62,9 @@ class ThresholdPlots {
 
     float GetXRange(TH1F *hist) const;
 
+    // Path of an object in the input file
+    std::string GetInputPath(std::string const& name) const;
+
     // Vector containing different optical flash threshold values
     std::vector< int > const fThresholdValues;
 
@@ -68,7 +91,17 @@ class ThresholdPlots {
     // Output filename of the EfficiencyPlots class
     std::string fInputFilename;
 
+    // Directory of the input file with the histograms 
+    // (empty unless we read the output of a scan)
+    std::string fInputDirectory;
+
+    // Name of the file we write the graphs to
+    std::string fOutputFilename;
+
     // Number of photon detectors in the geometry
     unsigned int const fNPDs;
 
+    // Time spent in every stage of the job (if enabled)
+    RunStatistics fStatistics;
+
 };